@@ -0,0 +1,271 @@
+#include "BatchConverter.h"
+#include "ProgramOptions.h"
+#include "VideoConverter.h"
+#include "ThreadPool.h"
+
+#include <opencv2/core.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+namespace fs = boost::filesystem;
+namespace pt = boost::property_tree;
+
+struct Job {
+	int line;
+	vector<string> options;
+};
+
+struct BatchConverter::Impl {
+	Impl(const ProgramOptions& po, int argc, char* argv[])
+		: m_ProgramOptions{po},
+		  m_Argc{argc},
+		  m_Argv{argv}
+	{
+		readJobs();
+	}
+
+	size_t run()
+	{
+		// a running job only writes its frames, the workers decode and convert
+		// them, so the jobs are not bound to the cores
+		size_t jobs = m_ProgramOptions.parallelJobs();
+
+		if (jobs == 0)
+			jobs = max(2u, thread::hardware_concurrency() / 2);
+
+		jobs = min(jobs, m_Jobs.size());
+
+		// the memory budget is shared by the running jobs
+		const auto budget = m_ProgramOptions.memoryBudget() / (1024 * 1024);
+		m_JobMemoryBudget = to_string(budget / jobs);
+
+		if (budget != 0 && budget / jobs == 0)
+			cerr << "memory budget of " << budget << "MiB is too small for " << jobs
+				 << " parallel jobs, converting one frame ahead" << endl;
+
+		// concurrent jobs cannot share a single console line
+		if (m_ProgramOptions.progress() == "human")
+		{
+			cerr << "human progress is not available with --jobs-file, using machine" << endl;
+			m_JobProgress = "machine";
+		}
+		else
+		{
+			m_JobProgress = m_ProgramOptions.progress();
+		}
+
+		// the workers convert whole frames, one per core, so the row bands of
+		// a frame run on the worker instead of the OpenCV pool
+		const auto openCVThreads = cv::getNumThreads();
+		cv::setNumThreads(0);
+
+		{
+			ThreadPool workers{thread::hardware_concurrency()};
+			ThreadPool encoders{jobs};
+
+			for (const auto& job : m_Jobs)
+				encoders.submit([this, &job, &workers] { convert(job, workers); });
+		}
+
+		cv::setNumThreads(openCVThreads);
+
+		return m_Failed;
+	}
+
+private:
+	void readJobs()
+	{
+		ifstream file{m_ProgramOptions.jobsFile()};
+
+		if (!file)
+			throw invalid_argument{"cannot open " + m_ProgramOptions.jobsFile()};
+
+		string line;
+		int lineNumber = 0;
+		map<string, int> outputs;
+
+		while (getline(file, line))
+		{
+			++lineNumber;
+
+			if (line.find_first_not_of(" \t\r") == string::npos || line[0] == '#')
+				continue;
+
+			auto options = parseJob(line, lineNumber);
+			checkJob(options, lineNumber, outputs);
+			m_Jobs.push_back(Job{lineNumber, move(options)});
+		}
+
+		if (m_Jobs.empty())
+			throw invalid_argument{"no jobs found in " + m_ProgramOptions.jobsFile()};
+	}
+
+	// Every key of the json object becomes a command line option, with short
+	// names for the common ones.
+	vector<string> parseJob(const string& line, int lineNumber) const
+	{
+		pt::ptree tree;
+
+		try
+		{
+			istringstream is{line};
+			pt::read_json(is, tree);
+		}
+		catch (const pt::json_parser_error& exc)
+		{
+			throw jobError(lineNumber, exc.message());
+		}
+
+		vector<string> options;
+
+		for (const auto& entry : tree)
+		{
+			if (!entry.second.empty())
+				throw jobError(lineNumber, "value of " + entry.first + " must be a string or a number");
+
+			const auto name = optionName(entry.first);
+
+			if (name == "memory-budget" || name == "progress")
+				throw jobError(lineNumber, name + " is shared by all the jobs and must be given on the command line");
+
+			options.push_back("--" + optionName(entry.first));
+			options.push_back(entry.second.data());
+		}
+
+		return options;
+	}
+
+	// Builds the program options of the job to reject, before any job runs,
+	// jobs reading stdin and jobs writing a file already written by another
+	// job. outputs maps the files of the previous jobs to their line.
+	void checkJob(const vector<string>& options, int lineNumber, map<string, int>& outputs) const
+	{
+		unique_ptr<ProgramOptions> po;
+
+		try
+		{
+			po = make_unique<ProgramOptions>(options, m_Argc, m_Argv);
+		}
+		catch (const exception& exc)
+		{
+			throw jobError(lineNumber, exc.what());
+		}
+
+		if (po->input() == "-")
+			throw jobError(lineNumber, "jobs cannot read from stdin");
+
+		for (const auto& filename : VideoConverter::outputFilenames(*po))
+		{
+			const auto output = outputs.emplace(normalizedPath(filename), lineNumber);
+
+			if (!output.second)
+				throw jobError(lineNumber, filename + " is also written by line "
+							   + to_string(output.first->second));
+		}
+	}
+
+	invalid_argument jobError(int lineNumber, const string& message) const
+	{
+		ostringstream os;
+		os << m_ProgramOptions.jobsFile() << ':' << lineNumber << ": " << message;
+		return invalid_argument{os.str()};
+	}
+
+	// Absolute path without . and .. components, so that the same file is
+	// recognized whatever the spelling. Links are not resolved: the files do
+	// not exist yet.
+	static string normalizedPath(const string& filename)
+	{
+		fs::path normalized;
+
+		for (const auto& part : fs::absolute(filename))
+		{
+			if (part == "..")
+				normalized.remove_filename();
+			else if (part != ".")
+				normalized /= part;
+		}
+
+		return normalized.string();
+	}
+
+	static string optionName(const string& key)
+	{
+		if (key == "mode")
+			return "video-mode";
+
+		if (key == "output")
+			return "out";
+
+		return key;
+	}
+
+	void convert(const Job& job, ThreadPool& workers) noexcept
+	{
+		try
+		{
+			auto options = job.options;
+			options.push_back("--memory-budget");
+			options.push_back(m_JobMemoryBudget);
+			options.push_back("--progress");
+			options.push_back(m_JobProgress);
+
+			ProgramOptions po{options, m_Argc, m_Argv};
+			VideoConverter vc{po, workers};
+			vc.generateVideo();
+
+			if (m_ProgramOptions.verbose() > 0)
+				log(cout, job, "done");
+		}
+		catch (const exception& exc)
+		{
+			++m_Failed;
+			log(cerr, job, exc.what());
+		}
+	}
+
+	void log(ostream& os, const Job& job, const string& message)
+	{
+		lock_guard<mutex> lock{m_LogMutex};
+		os << m_ProgramOptions.jobsFile() << ':' << job.line << ": " << message << endl;
+	}
+
+private:
+	const ProgramOptions& m_ProgramOptions;
+	const int m_Argc;
+	char** const m_Argv;
+
+	vector<Job> m_Jobs;
+	string m_JobMemoryBudget;
+	string m_JobProgress;
+	atomic<size_t> m_Failed{0};
+	mutex m_LogMutex;
+};
+
+BatchConverter::BatchConverter(const ProgramOptions& po, int argc, char* argv[])
+	: m_Impl{make_unique<BatchConverter::Impl>(po, argc, argv)}
+{
+}
+
+BatchConverter::~BatchConverter()
+{
+}
+
+size_t BatchConverter::run()
+{
+	return m_Impl->run();
+}
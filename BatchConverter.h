@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+class ProgramOptions;
+
+// Runs the conversions listed in the jobs file of the program options in
+// this process, several at a time. The frames of all the running jobs are
+// decoded and converted by a single pool of worker threads, one per core,
+// while every job writes its own frames in order.
+class BatchConverter {
+public:
+	BatchConverter(const ProgramOptions& po, int argc, char* argv[]);
+	~BatchConverter();
+
+	BatchConverter(const BatchConverter&) = delete;
+	BatchConverter& operator = (const BatchConverter&) = delete;
+	BatchConverter(BatchConverter&&) = delete;
+	BatchConverter& operator = (BatchConverter&&) = delete;
+
+	// Returns the number of jobs that failed.
+	std::size_t run();
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> m_Impl;
+};
@@ -0,0 +1,349 @@
+#include "FrameSource.h"
+#include "VideoConverter.h"
+
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+using namespace std;
+
+FrameSource::~FrameSource()
+{
+}
+
+ImageSequenceSource::ImageSequenceSource(const vector<Frame>& frames, ImageDecoder decoder)
+	: m_Frames(frames),
+	  m_Decoder{decoder}
+{
+}
+
+bool ImageSequenceSource::read(cv::Mat& frame)
+{
+	if (m_Next >= m_Frames.size())
+		return false;
+
+	m_Name = m_Frames[m_Next++].absolutePath;
+	loadImage(m_Name, frame, m_Decoder);
+	return true;
+}
+
+const string& ImageSequenceSource::name() const noexcept
+{
+	return m_Name;
+}
+
+StreamFrameSource::StreamFrameSource(FILE* stream, const string& format,
+									 const string& pixelFormat, const cv::Size& frameSize)
+	: m_Stream{stream},
+	  m_Framed{format == "y4m"},
+	  m_RGBA{pixelFormat == "rgba"},
+	  m_FrameSize{frameSize}
+{
+	if (format != "raw" && format != "y4m")
+		throw invalid_argument{"unknown input format " + format};
+
+	if (pixelFormat != "bgra" && pixelFormat != "rgba")
+		throw invalid_argument{"unknown pixel format " + pixelFormat};
+
+#ifdef _WIN32
+	_setmode(_fileno(m_Stream), _O_BINARY);
+#endif
+
+	// frames are read straight into the destination, the buffer is mostly
+	// used by the header lines
+	setvbuf(m_Stream, nullptr, _IOFBF, 1 << 22);
+
+	if (m_Framed)
+		readStreamHeader();
+
+	if (m_FrameSize.width < 1 || m_FrameSize.height < 1)
+		throw invalid_argument{"frame size is required when reading raw frames"};
+}
+
+StreamFrameSource::~StreamFrameSource()
+{
+}
+
+bool StreamFrameSource::read(cv::Mat& frame)
+{
+	if (m_Eof)
+		return false;
+
+	if (m_Framed && !readFrameHeader())
+		return false;
+
+	frame.create(m_FrameSize, CV_8UC4);
+
+	const auto bytes = frame.total() * frame.elemSize();
+	const auto readBytes = fread(frame.data, 1, bytes, m_Stream);
+
+	if (readBytes == 0 && !m_Framed && feof(m_Stream))
+	{
+		m_Eof = true;
+		return false;
+	}
+
+	m_Name = "stdin frame " + to_string(++m_Count);
+
+	if (readBytes != bytes)
+	{
+		m_Eof = true;
+		throw runtime_error{"truncated frame"};
+	}
+
+	if (m_RGBA)
+		cv::cvtColor(frame, frame, cv::COLOR_RGBA2BGRA);
+
+	return true;
+}
+
+const string& StreamFrameSource::name() const noexcept
+{
+	return m_Name;
+}
+
+const cv::Size& StreamFrameSource::frameSize() const noexcept
+{
+	return m_FrameSize;
+}
+
+double StreamFrameSource::fps() const noexcept
+{
+	return m_FPS;
+}
+
+void StreamFrameSource::readStreamHeader()
+{
+	istringstream header{readLine()};
+	string token;
+	string colorspace;
+
+	header >> token;
+	if (token != "YUV4MPEG2")
+		throw invalid_argument{"invalid stream header"};
+
+	while (header >> token)
+	{
+		if (token[0] == 'W')
+			m_FrameSize.width = stoi(token.substr(1));
+		else if (token[0] == 'H')
+			m_FrameSize.height = stoi(token.substr(1));
+		else if (token[0] == 'C')
+			colorspace = token.substr(1);
+		else if (token[0] == 'F')
+			readFrameRate(token.substr(1));
+	}
+
+	// without a C tag y4m means 420jpeg
+	if (colorspace != "bgra" && colorspace != "rgba")
+		throw invalid_argument{"stream colorspace " + (colorspace.empty() ? string{"420jpeg"} : colorspace)
+							   + " is not supported, the header needs Cbgra or Crgba"};
+
+	m_RGBA = colorspace == "rgba";
+}
+
+void StreamFrameSource::readFrameRate(const string& rate)
+{
+	const auto colon = rate.find(':');
+
+	if (colon == string::npos)
+		throw invalid_argument{"invalid stream frame rate " + rate};
+
+	const auto numerator = stoi(rate.substr(0, colon));
+	const auto denominator = stoi(rate.substr(colon + 1));
+
+	if (numerator < 1 || denominator < 1)
+		throw invalid_argument{"invalid stream frame rate " + rate};
+
+	m_FPS = static_cast<double>(numerator) / denominator;
+}
+
+bool StreamFrameSource::readFrameHeader()
+{
+	const auto line = readLine();
+
+	if (m_Eof)
+		return false;
+
+	if (line.compare(0, 5, "FRAME") != 0)
+	{
+		m_Eof = true;
+		throw runtime_error{"invalid frame header"};
+	}
+
+	return true;
+}
+
+string StreamFrameSource::readLine()
+{
+	string line;
+	int c;
+
+	while ((c = getc(m_Stream)) != EOF && c != '\n')
+	{
+		line += static_cast<char>(c);
+
+		if (line.size() > 4096)
+			throw runtime_error{"stream header line too long"};
+	}
+
+	if (c == EOF && line.empty())
+		m_Eof = true;
+
+	return line;
+}
+
+PrefetchingFrameSource::PrefetchingFrameSource(unique_ptr<FrameSource> source, size_t capacity)
+	: m_Source{move(source)},
+	  m_Capacity{capacity}
+{
+	if (m_Capacity < 2)
+		throw invalid_argument{"read ahead requires room for at least two frames"};
+}
+
+PrefetchingFrameSource::~PrefetchingFrameSource()
+{
+	{
+		lock_guard<mutex> lock{m_Mutex};
+		m_Stop = true;
+	}
+
+	m_CanPush.notify_all();
+
+	if (m_Thread.joinable())
+		m_Thread.join();
+}
+
+bool PrefetchingFrameSource::read(cv::Mat& frame)
+{
+	if (m_Finished)
+		return false;
+
+	// started on the first read so that nothing is consumed before the
+	// output is ready
+	if (!m_Thread.joinable())
+		m_Thread = thread{&PrefetchingFrameSource::readAhead, this};
+
+	Item item;
+
+	{
+		unique_lock<mutex> lock{m_Mutex};
+		m_CanPop.wait(lock, [this] { return !m_Queue.empty(); });
+
+		item = move(m_Queue.front());
+		m_Queue.pop_front();
+
+		if (item.error || item.last)
+		{
+			// the consumer keeps its current frame, the buffer of the frame
+			// that could not be read goes back to the reader
+			if (!item.frame.empty())
+				recycle(item.frame);
+		}
+		else
+		{
+			// the previous frame of the consumer is done, its buffer is reused
+			if (m_ConsumerHoldsFrame && !frame.empty())
+				recycle(frame);
+
+			m_ConsumerHoldsFrame = true;
+		}
+	}
+
+	m_CanPush.notify_one();
+	m_Name = move(item.name);
+
+	if (item.error)
+		rethrow_exception(item.error);
+
+	if (item.last)
+	{
+		m_Finished = true;
+		return false;
+	}
+
+	frame = item.frame;
+	return true;
+}
+
+const string& PrefetchingFrameSource::name() const noexcept
+{
+	return m_Name;
+}
+
+void PrefetchingFrameSource::readAhead()
+{
+	for (;;)
+	{
+		Item item;
+
+		{
+			unique_lock<mutex> lock{m_Mutex};
+			m_CanPush.wait(lock, [this]
+			{
+				return m_Stop || !m_FreeFrames.empty() || residentFrames() < m_Capacity;
+			});
+
+			if (m_Stop)
+				return;
+
+			if (!m_FreeFrames.empty())
+			{
+				item.frame = m_FreeFrames.back();
+				m_FreeFrames.pop_back();
+			}
+
+			m_Reading = true;
+		}
+
+		try
+		{
+			item.last = !m_Source->read(item.frame);
+		}
+		catch (...)
+		{
+			item.error = current_exception();
+		}
+
+		item.name = m_Source->name();
+		const auto last = item.last;
+
+		{
+			lock_guard<mutex> lock{m_Mutex};
+			m_Queue.push_back(move(item));
+			m_Reading = false;
+		}
+
+		m_CanPop.notify_one();
+
+		if (last)
+			return;
+	}
+}
+
+// Called with m_Mutex locked.
+size_t PrefetchingFrameSource::residentFrames() const noexcept
+{
+	return m_Queue.size() + m_FreeFrames.size()
+			+ (m_Reading ? 1 : 0) + (m_ConsumerHoldsFrame ? 1 : 0);
+}
+
+// Called with m_Mutex locked, frame is released.
+void PrefetchingFrameSource::recycle(cv::Mat& frame)
+{
+	const auto alreadyFree = any_of(begin(m_FreeFrames), end(m_FreeFrames),
+									[&frame](const cv::Mat& f) { return f.data == frame.data; });
+
+	if (alreadyFree)
+		throw logic_error{"frame buffer recycled twice"};
+
+	m_FreeFrames.push_back(frame);
+	frame.release();
+}
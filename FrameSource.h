@@ -0,0 +1,133 @@
+#pragma once
+
+#include "opencvhelper.h"
+
+#include <opencv2/core.hpp>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Frame;
+
+// Sequential source of BGRA frames feeding the encode loop.
+class FrameSource {
+public:
+	virtual ~FrameSource();
+
+	// Reads the next frame, returns false when the sequence is over. A frame
+	// that cannot be read throws and the following call moves to the next one.
+	virtual bool read(cv::Mat& frame) = 0;
+
+	// Name of the last frame read, used in messages.
+	virtual const std::string& name() const noexcept = 0;
+};
+
+// Frames loaded from the image files discovered on disk.
+class ImageSequenceSource : public FrameSource {
+public:
+	ImageSequenceSource(const std::vector<Frame>& frames, ImageDecoder decoder);
+
+	bool read(cv::Mat& frame) override;
+	const std::string& name() const noexcept override;
+
+private:
+	const std::vector<Frame>& m_Frames;
+	const ImageDecoder m_Decoder;
+	std::size_t m_Next = 0;
+	std::string m_Name;
+};
+
+// Raw frames read from a stream, typically stdin, either headerless with the
+// size and pixel format given by the user or framed like y4m:
+//   YUV4MPEG2 W<width> H<height> C<bgra|rgba> [F<num>:<den>] ...\n
+//   FRAME\n<width * height * 4 bytes>
+//   ...
+// The C tag is required so that a real y4m stream, which carries YUV, is
+// rejected instead of being read as BGRA. Pixels are bgra or rgba, the
+// latter is swizzled to BGRA.
+class StreamFrameSource : public FrameSource {
+public:
+	StreamFrameSource(std::FILE* stream, const std::string& format,
+					  const std::string& pixelFormat, const cv::Size& frameSize);
+	~StreamFrameSource();
+
+	StreamFrameSource(const StreamFrameSource&) = delete;
+	StreamFrameSource& operator = (const StreamFrameSource&) = delete;
+
+	bool read(cv::Mat& frame) override;
+	const std::string& name() const noexcept override;
+
+	const cv::Size& frameSize() const noexcept;
+
+	// Frame rate of the F tag of a framed stream, 0 when unknown.
+	double fps() const noexcept;
+
+private:
+	void readStreamHeader();
+	void readFrameRate(const std::string& rate);
+	bool readFrameHeader();
+	std::string readLine();
+
+private:
+	std::FILE* m_Stream;
+	const bool m_Framed;
+	bool m_RGBA;
+	cv::Size m_FrameSize;
+	double m_FPS = 0;
+	int m_Count = 0;
+	bool m_Eof = false;
+	std::string m_Name;
+};
+
+// Reads frames of another source ahead of the consumer on a separate thread.
+// At most capacity frame buffers exist at any time, counting the queued ones,
+// the ones kept for reuse, the one being read and the one held by the
+// consumer: the reader blocks when they are all in use. The buffer of a
+// frame returned by read() is reused by the following read(), so the
+// consumer must not keep references to it. capacity must be at least 2.
+class PrefetchingFrameSource : public FrameSource {
+public:
+	PrefetchingFrameSource(std::unique_ptr<FrameSource> source, std::size_t capacity);
+	~PrefetchingFrameSource();
+
+	PrefetchingFrameSource(const PrefetchingFrameSource&) = delete;
+	PrefetchingFrameSource& operator = (const PrefetchingFrameSource&) = delete;
+
+	bool read(cv::Mat& frame) override;
+	const std::string& name() const noexcept override;
+
+private:
+	struct Item {
+		cv::Mat frame;
+		std::string name;
+		std::exception_ptr error;
+		bool last = false;
+	};
+
+	void readAhead();
+	std::size_t residentFrames() const noexcept;
+	void recycle(cv::Mat& frame);
+
+private:
+	std::unique_ptr<FrameSource> m_Source;
+	const std::size_t m_Capacity;
+
+	std::deque<Item> m_Queue;
+	std::vector<cv::Mat> m_FreeFrames;
+	std::mutex m_Mutex;
+	std::condition_variable m_CanPush;
+	std::condition_variable m_CanPop;
+	bool m_Stop = false;
+	bool m_Reading = false;
+	bool m_ConsumerHoldsFrame = false;
+
+	bool m_Finished = false;
+	std::string m_Name;
+	std::thread m_Thread;
+};
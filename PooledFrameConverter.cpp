@@ -0,0 +1,103 @@
+#include "PooledFrameConverter.h"
+#include "ThreadPool.h"
+#include "VideoConverter.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+PooledFrameConverter::PooledFrameConverter(ThreadPool& pool, const vector<Frame>& frames,
+										   ImageDecoder decoder, FrameConversion conversion,
+										   size_t slots)
+	: m_Pool(pool),
+	  m_Frames(frames),
+	  m_Decoder{decoder},
+	  m_Conversion{move(conversion)},
+	  m_Slots(max<size_t>(1, min(slots, frames.size())))
+{
+	for (size_t i = 0; i < m_Slots.size() && i < m_Frames.size(); ++i)
+		submit(i);
+}
+
+PooledFrameConverter::~PooledFrameConverter()
+{
+	unique_lock<mutex> lock{m_Mutex};
+	m_Done.wait(lock, [this] { return m_Pending == 0; });
+}
+
+bool PooledFrameConverter::read(vector<cv::Mat>& converted)
+{
+	if (m_Next >= m_Frames.size())
+		return false;
+
+	auto& slot = m_Slots[m_Next % m_Slots.size()];
+	exception_ptr error;
+
+	{
+		unique_lock<mutex> lock{m_Mutex};
+		m_Done.wait(lock, [&slot] { return slot.ready; });
+
+		// the buffers of the previous frame go back to the slot
+		if (slot.error)
+			swap(error, slot.error);
+		else
+			swap(slot.converted, converted);
+
+		slot.ready = false;
+	}
+
+	m_Name = m_Frames[m_Next].absolutePath;
+
+	const auto next = m_Next + m_Slots.size();
+	++m_Next;
+
+	if (next < m_Frames.size())
+		submit(next);
+
+	if (error)
+		rethrow_exception(error);
+
+	return true;
+}
+
+const string& PooledFrameConverter::name() const noexcept
+{
+	return m_Name;
+}
+
+void PooledFrameConverter::submit(size_t index)
+{
+	{
+		lock_guard<mutex> lock{m_Mutex};
+		++m_Pending;
+	}
+
+	auto& slot = m_Slots[index % m_Slots.size()];
+	const auto& filename = m_Frames[index].absolutePath;
+
+	m_Pool.submit([this, &slot, &filename] { process(slot, filename); });
+}
+
+void PooledFrameConverter::process(Slot& slot, const string& filename) noexcept
+{
+	exception_ptr error;
+
+	// whatever goes wrong with a frame only skips that frame
+	try
+	{
+		loadImage(filename, slot.frame, m_Decoder);
+		m_Conversion(slot.frame, slot.converted);
+	}
+	catch (const exception& exc)
+	{
+		error = make_exception_ptr(runtime_error{exc.what()});
+	}
+
+	// notified under the lock, the destructor may run as soon as it is released
+	lock_guard<mutex> lock{m_Mutex};
+	slot.error = error;
+	slot.ready = true;
+	--m_Pending;
+	m_Done.notify_all();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "opencvhelper.h"
+
+#include <opencv2/core.hpp>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct Frame;
+class ThreadPool;
+
+// Converts a decoded BGRA frame into the buffers written by the encoder.
+// converted holds the buffers of an earlier conversion, to be reused. It is
+// called concurrently for different frames.
+using FrameConversion = std::function<void(const cv::Mat& frame, std::vector<cv::Mat>& converted)>;
+
+// Decodes and converts the frames of an image sequence as tasks of a pool
+// shared by several conversions, so that the cores are spread over the
+// frames of all the sequences, and hands them back in order to the encode
+// loop. At most slots frames are decoded or converted ahead of the encoder,
+// each slot holding a decoded frame and its converted buffers. The buffers
+// returned by read() are reused by the following read(), so the consumer
+// must not keep references to them.
+class PooledFrameConverter {
+public:
+	PooledFrameConverter(ThreadPool& pool, const std::vector<Frame>& frames, ImageDecoder decoder,
+						 FrameConversion conversion, std::size_t slots);
+
+	// Waits for the tasks already submitted.
+	~PooledFrameConverter();
+
+	PooledFrameConverter(const PooledFrameConverter&) = delete;
+	PooledFrameConverter& operator = (const PooledFrameConverter&) = delete;
+
+	// Reads the converted buffers of the next frame, returns false when the
+	// sequence is over. A frame that cannot be decoded or converted throws
+	// runtime_error and the following call moves to the next one.
+	bool read(std::vector<cv::Mat>& converted);
+
+	// Name of the last frame read, used in messages.
+	const std::string& name() const noexcept;
+
+private:
+	struct Slot {
+		cv::Mat frame;
+		std::vector<cv::Mat> converted;
+		std::exception_ptr error;
+		bool ready = false;
+	};
+
+	void submit(std::size_t index);
+	void process(Slot& slot, const std::string& filename) noexcept;
+
+private:
+	ThreadPool& m_Pool;
+	const std::vector<Frame>& m_Frames;
+	const ImageDecoder m_Decoder;
+	const FrameConversion m_Conversion;
+
+	std::vector<Slot> m_Slots;
+	std::size_t m_Next = 0;
+	std::size_t m_Pending = 0;
+	std::mutex m_Mutex;
+	std::condition_variable m_Done;
+
+	std::string m_Name;
+};
@@ -5,6 +5,7 @@
 #include <iostream>
 #include <stdexcept>
 #include <sstream>
+#include <regex>
 
 
 using namespace std;
@@ -16,17 +17,38 @@ enum class VerboseLevel : int {
 
 struct ProgramOptions::Impl {
 public:
-	Impl(int argc, char* argv[])
+	Impl(const vector<string>& overrides, int argc, char* argv[])
 		: m_CommandLineArgCount{argc}
 	{
 		initializeOptions();
 
+		// the values stored first win, so overrides take precedence over argv
+		if (!overrides.empty())
+			po::store(po::command_line_parser(overrides).options(m_Desc).run(), m_OptionsMap);
+
 		po::store(po::parse_command_line(argc, argv, m_Desc), m_OptionsMap);
 		po::notify(m_OptionsMap);
 
 		if (!isFourCCValid())
 			throw invalid_argument{"unknow fourcc code"};
 
+		if (!isInputFormatValid())
+			throw invalid_argument{"unknown input format"};
+
+		if (!isPixelFormatValid())
+			throw invalid_argument{"unknown pixel format"};
+
+		if (!isPNGDecoderValid())
+			throw invalid_argument{"unknown png decoder"};
+
+		if (!isProgressValid())
+			throw invalid_argument{"unknown progress format"};
+
+		if (m_ProgressInterval <= 0)
+			throw invalid_argument{"progress-interval must be greater than 0"};
+
+		parseFrameSize();
+
 		if (shouldDisplayOnlyHelp())
 			cout << *this << endl;
 
@@ -86,6 +108,61 @@ public:
         return m_VideoMode;
     }
 
+	const string& input() const noexcept
+	{
+		return m_Input;
+	}
+
+	const string& inputFormat() const noexcept
+	{
+		return m_InputFormat;
+	}
+
+	const string& pixelFormat() const noexcept
+	{
+		return m_PixelFormat;
+	}
+
+	const cv::Size& frameSize() const noexcept
+	{
+		return m_FrameSize;
+	}
+
+	const string& pngDecoder() const noexcept
+	{
+		return m_PNGDecoder;
+	}
+
+	bool shouldComparePNGDecoders() const noexcept
+	{
+		return exist("compare-png-decoders");
+	}
+
+	size_t memoryBudget() const noexcept
+	{
+		return m_MemoryBudget * 1024 * 1024;
+	}
+
+	const string& jobsFile() const noexcept
+	{
+		return m_JobsFile;
+	}
+
+	unsigned parallelJobs() const noexcept
+	{
+		return m_ParallelJobs;
+	}
+
+	const string& progress() const noexcept
+	{
+		return m_Progress;
+	}
+
+	int progressInterval() const noexcept
+	{
+		return m_ProgressInterval;
+	}
+
 	friend ostream& operator << (ostream& os, const Impl& imp)
 	{
 		if (imp.shouldDisplayOnlyHelp())
@@ -114,6 +191,31 @@ private:
 		m_Desc.add_options()
 				("help,h", "produce this message")
 				("version", "show program version")
+				("input,i", po::value<string>(&m_Input)->default_value("."),
+				 "directory containing the images, - to read frames from stdin")
+				("input-format", po::value<string>(&m_InputFormat)->default_value("raw"),
+				 "format of the frames read from stdin:\n"
+				 "raw -> headerless frames, requires --size\n"
+				 "y4m -> YUV4MPEG2 like header with a Cbgra or Crgba tag followed by FRAME lines")
+				("size,s", po::value<string>(&m_Size),
+				 "size WxH of the frames read from stdin")
+				("pixel-format", po::value<string>(&m_PixelFormat)->default_value("bgra"),
+				 "pixel format of the raw frames read from stdin: bgra or rgba")
+				("png-decoder", po::value<string>(&m_PNGDecoder)->default_value("auto"),
+				 "decoder used for png images:\n"
+				 "auto -> libpng for 8 bit RGBA images when available\n"
+				 "freeimage -> always FreeImage")
+				("compare-png-decoders",
+				 "decode the images with both png decoders, print the timings and "
+				 "check that the frames are identical, no video is generated")
+				("memory-budget", po::value<size_t>(&m_MemoryBudget)->default_value(256),
+				 "memory in MiB for the frames decoded ahead of the encoder, 0 disables read ahead")
+				("jobs-file", po::value<string>(&m_JobsFile),
+				 "file with one conversion per line, as a json object whose keys are "
+				 "options, e.g. {\"input\": \"dir\", \"prefix\": \"image\", \"mode\": 2, "
+				 "\"output\": \"video\"}; the other options are the defaults of every job")
+				("parallel-jobs", po::value<unsigned>(&m_ParallelJobs)->default_value(0),
+				 "conversions of the jobs file run at the same time, 0 for one every two cores, at least two")
 				("prefix,p",
 				 po::value<string>(&m_Prefix)->default_value("image"),
 				 "prefix of files")
@@ -125,6 +227,14 @@ private:
 				 "frame per seconds")
 				("fourcc,c", po::value<std::string>(&m_FourCC)->default_value("x264"s),
 				 "fourcc code do use for encoding see: http://www.fourcc.org/codecs.php for other codecs")
+				("progress", po::value<string>(&m_Progress)->default_value("none"),
+				 "progress report:\n"
+				 "none -> no report\n"
+				 "human -> frames, fps, MiB/s and ETA on a single console line, "
+				 "machine with --jobs-file\n"
+				 "machine -> one progress line with key=value fields per update")
+				("progress-interval", po::value<int>(&m_ProgressInterval)->default_value(500),
+				 "milliseconds between progress updates")
 				("verbose,v", po::value<int>(&m_Verbose)->default_value(0),
                  "verbose level")
                 ("video-mode,m", po::value<int>(&m_VideoMode)->default_value(1),
@@ -139,16 +249,52 @@ private:
 		return m_FourCC.length() == 4;
 	}
 
+	bool isInputFormatValid() const
+	{
+		return m_InputFormat == "raw" || m_InputFormat == "y4m";
+	}
+
+	bool isPixelFormatValid() const
+	{
+		return m_PixelFormat == "bgra" || m_PixelFormat == "rgba";
+	}
+
+	bool isProgressValid() const
+	{
+		return m_Progress == "none" || m_Progress == "human" || m_Progress == "machine";
+	}
+
+	bool isPNGDecoderValid() const
+	{
+		return m_PNGDecoder == "auto" || m_PNGDecoder == "freeimage";
+	}
+
+	void parseFrameSize()
+	{
+		if (!exist("size"))
+			return;
+
+		static const regex re{R"((\d+)x(\d+))"};
+		smatch stringMatch;
+
+		if (!regex_match(m_Size, stringMatch, re))
+			throw invalid_argument{"invalid frame size " + m_Size};
+
+		m_FrameSize = cv::Size{stoi(stringMatch.str(1)), stoi(stringMatch.str(2))};
+	}
+
 	string printParameters() const noexcept
 	{
 		ostringstream os;
 
-        os << "prefix:     " << m_Prefix << '\n'
+        os << "input:      " << m_Input << '\n'
+           << "prefix:     " << m_Prefix << '\n'
            << "out:        " << m_VideoName << '\n'
            << "extension:  " << m_VideoExtension << '\n'
            << "fps:        " << m_FPS << '\n'
            << "fourcc:     " << m_FourCC << '\n'
-           << "video-mode: " << m_VideoMode << endl
+           << "video-mode: " << m_VideoMode << '\n'
+           << "memory-budget: " << m_MemoryBudget << "MiB\n"
            << "verbose:    " << m_Verbose << endl;
 
 		return os.str();
@@ -184,6 +330,18 @@ private:
 	double m_FPS;
 	string m_FourCC;
 
+	string m_Input;
+	string m_InputFormat;
+	string m_PixelFormat;
+	string m_Size;
+	cv::Size m_FrameSize;
+	string m_PNGDecoder;
+	size_t m_MemoryBudget;
+	string m_JobsFile;
+	unsigned m_ParallelJobs;
+	string m_Progress;
+	int m_ProgressInterval;
+
 	string m_Prefix;
 	string m_VideoName;
 	string m_VideoExtension;
@@ -193,7 +351,12 @@ private:
 };
 
 ProgramOptions::ProgramOptions(int argc, char* argv[])
-	: m_Impl{make_unique<ProgramOptions::Impl>(argc, argv)}
+	: m_Impl{make_unique<ProgramOptions::Impl>(vector<string>{}, argc, argv)}
+{
+}
+
+ProgramOptions::ProgramOptions(const vector<string>& overrides, int argc, char* argv[])
+	: m_Impl{make_unique<ProgramOptions::Impl>(overrides, argc, argv)}
 {
 }
 
@@ -241,6 +404,61 @@ int ProgramOptions::videoMode() const noexcept
     return m_Impl->videoMode();
 }
 
+const string&ProgramOptions::input() const noexcept
+{
+	return m_Impl->input();
+}
+
+const string&ProgramOptions::inputFormat() const noexcept
+{
+	return m_Impl->inputFormat();
+}
+
+const string&ProgramOptions::pixelFormat() const noexcept
+{
+	return m_Impl->pixelFormat();
+}
+
+const cv::Size&ProgramOptions::frameSize() const noexcept
+{
+	return m_Impl->frameSize();
+}
+
+const string&ProgramOptions::pngDecoder() const noexcept
+{
+	return m_Impl->pngDecoder();
+}
+
+bool ProgramOptions::shouldComparePNGDecoders() const noexcept
+{
+	return m_Impl->shouldComparePNGDecoders();
+}
+
+size_t ProgramOptions::memoryBudget() const noexcept
+{
+	return m_Impl->memoryBudget();
+}
+
+const string&ProgramOptions::jobsFile() const noexcept
+{
+	return m_Impl->jobsFile();
+}
+
+unsigned ProgramOptions::parallelJobs() const noexcept
+{
+	return m_Impl->parallelJobs();
+}
+
+const string&ProgramOptions::progress() const noexcept
+{
+	return m_Impl->progress();
+}
+
+int ProgramOptions::progressInterval() const noexcept
+{
+	return m_Impl->progressInterval();
+}
+
 ostream& operator <<(ostream& os, const ProgramOptions& options)
 {
 	return os << *options.m_Impl << endl;
@@ -2,12 +2,18 @@
 
 #include <string>
 #include <memory>
+#include <vector>
 #include <iosfwd>
 #include <boost/filesystem.hpp>
+#include <opencv2/core.hpp>
 
 class ProgramOptions {
 public:
 	ProgramOptions(int argc, char* argv[]);
+
+	// Options of argv where the ones in overrides, given as command line
+	// tokens, are replaced.
+	ProgramOptions(const std::vector<std::string>& overrides, int argc, char* argv[]);
 	~ProgramOptions();
 
 	ProgramOptions(const ProgramOptions&) = delete;
@@ -27,6 +33,18 @@ public:
 
     int videoMode() const noexcept;
 
+	const std::string& input() const noexcept;
+	const std::string& inputFormat() const noexcept;
+	const std::string& pixelFormat() const noexcept;
+	const cv::Size& frameSize() const noexcept;
+	const std::string& pngDecoder() const noexcept;
+	bool shouldComparePNGDecoders() const noexcept;
+	std::size_t memoryBudget() const noexcept;
+	const std::string& jobsFile() const noexcept;
+	unsigned parallelJobs() const noexcept;
+	const std::string& progress() const noexcept;
+	int progressInterval() const noexcept;
+
 	friend std::ostream& operator << (std::ostream& os, const ProgramOptions& options);
 
 private:
@@ -0,0 +1,124 @@
+#include "ProgressReporter.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+namespace {
+
+// shared by the reporters of concurrent conversions
+mutex outputMutex;
+
+} // namespace
+
+ProgressReporter::ProgressReporter(Format format, const string& name, size_t totalFrames,
+								   size_t frameBytes, chrono::milliseconds interval)
+	: m_Format{format},
+	  m_Name{name},
+	  m_TotalFrames{totalFrames},
+	  m_FrameBytes{frameBytes},
+	  m_Interval{interval},
+	  m_Start{chrono::steady_clock::now()}
+{
+	if (m_Format != Format::None)
+		m_Thread = thread{&ProgressReporter::run, this};
+}
+
+ProgressReporter::~ProgressReporter()
+{
+	stop(Status::Failed);
+}
+
+void ProgressReporter::finish()
+{
+	stop(Status::Done);
+}
+
+void ProgressReporter::stop(Status status)
+{
+	if (!m_Thread.joinable())
+		return;
+
+	{
+		lock_guard<mutex> lock{m_Mutex};
+		m_Stop = true;
+	}
+
+	m_StopRequested.notify_one();
+	m_Thread.join();
+
+	report(status);
+}
+
+void ProgressReporter::run()
+{
+	unique_lock<mutex> lock{m_Mutex};
+
+	while (!m_StopRequested.wait_for(lock, m_Interval, [this] { return m_Stop; }))
+		report(Status::Running);
+}
+
+void ProgressReporter::report(Status status)
+{
+	const auto done = m_FramesDone.load(memory_order_relaxed);
+	const chrono::duration<double> elapsed = chrono::steady_clock::now() - m_Start;
+	const auto seconds = max(elapsed.count(), 1e-6);
+	const auto fps = done / seconds;
+	const auto mebibytesPerSecond = fps * m_FrameBytes / (1024 * 1024);
+	const auto remaining = m_TotalFrames > done ? m_TotalFrames - done : 0;
+	const auto eta = fps > 0 ? remaining / fps : 0;
+
+	ostringstream os;
+	os << fixed << setprecision(1);
+
+	if (m_Format == Format::Machine)
+	{
+		static const char* statusNames[] = {"running", "done", "failed"};
+
+		os << "progress name=" << m_Name
+		   << " frames=" << done
+		   << " total=" << m_TotalFrames
+		   << " fps=" << fps
+		   << " mibps=" << mebibytesPerSecond
+		   << " elapsed=" << seconds;
+
+		if (m_TotalFrames > 0)
+			os << " eta=" << eta;
+
+		os << " status=" << statusNames[static_cast<int>(status)] << '\n';
+	}
+	else
+	{
+		os << m_Name << ": " << done;
+
+		if (m_TotalFrames > 0)
+			os << '/' << m_TotalFrames;
+
+		os << " frames, " << fps << " fps, " << mebibytesPerSecond << " MiB/s";
+
+		if (status == Status::Done)
+			os << ", done in " << seconds << 's';
+		else if (status == Status::Failed)
+			os << ", failed after " << seconds << 's';
+		else if (m_TotalFrames > 0)
+			os << ", ETA " << eta << 's';
+
+		// spaces clear what is left of a longer previous line
+		auto line = os.str();
+		const auto length = line.size();
+
+		if (length < m_LastLineLength)
+			line.append(m_LastLineLength - length, ' ');
+
+		m_LastLineLength = length;
+
+		os.str("");
+		os << '\r' << line << (status == Status::Running ? "" : "\n");
+	}
+
+	lock_guard<mutex> lock{outputMutex};
+	cout << os.str() << flush;
+}
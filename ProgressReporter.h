@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Reports frames done, frame rate, throughput and ETA of a conversion from a
+// separate thread, at most once per interval, so the encode loop only bumps
+// an atomic counter.
+class ProgressReporter {
+public:
+	enum class Format {
+		None,
+		Human,      // single console line rewritten in place
+		Machine     // one key=value line per update
+	};
+
+	// totalFrames is 0 when unknown, e.g. when reading from stdin.
+	ProgressReporter(Format format, const std::string& name, std::size_t totalFrames,
+					 std::size_t frameBytes, std::chrono::milliseconds interval);
+	~ProgressReporter();
+
+	ProgressReporter(const ProgressReporter&) = delete;
+	ProgressReporter& operator = (const ProgressReporter&) = delete;
+	ProgressReporter(ProgressReporter&&) = delete;
+	ProgressReporter& operator = (ProgressReporter&&) = delete;
+
+	void frameDone() noexcept
+	{
+		m_FramesDone.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// Stops the updates and prints the final report of a conversion that
+	// succeeded. A reporter destroyed before finish() reports a failure.
+	void finish();
+
+private:
+	enum class Status {
+		Running,
+		Done,
+		Failed
+	};
+
+	void stop(Status status);
+	void run();
+	void report(Status status);
+
+private:
+	const Format m_Format;
+	const std::string m_Name;
+	const std::size_t m_TotalFrames;
+	const std::size_t m_FrameBytes;
+	const std::chrono::milliseconds m_Interval;
+	const std::chrono::steady_clock::time_point m_Start;
+
+	std::atomic<std::size_t> m_FramesDone{0};
+	std::size_t m_LastLineLength = 0;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_StopRequested;
+	bool m_Stop = false;
+	std::thread m_Thread;
+};
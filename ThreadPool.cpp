@@ -0,0 +1,73 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+ThreadPool::ThreadPool(size_t threads)
+{
+	threads = max<size_t>(1, threads);
+
+	for (size_t i = 0; i < threads; ++i)
+		m_Threads.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	wait();
+
+	{
+		lock_guard<mutex> lock{m_Mutex};
+		m_Stop = true;
+	}
+
+	m_HasTask.notify_all();
+
+	for (auto& t : m_Threads)
+		t.join();
+}
+
+void ThreadPool::submit(function<void()> task)
+{
+	{
+		lock_guard<mutex> lock{m_Mutex};
+		m_Tasks.push_back(move(task));
+	}
+
+	m_HasTask.notify_one();
+}
+
+void ThreadPool::wait()
+{
+	unique_lock<mutex> lock{m_Mutex};
+	m_Idle.wait(lock, [this] { return m_Tasks.empty() && m_Running == 0; });
+}
+
+void ThreadPool::work()
+{
+	for (;;)
+	{
+		function<void()> task;
+
+		{
+			unique_lock<mutex> lock{m_Mutex};
+			m_HasTask.wait(lock, [this] { return m_Stop || !m_Tasks.empty(); });
+
+			if (m_Tasks.empty())
+				return;
+
+			task = move(m_Tasks.front());
+			m_Tasks.pop_front();
+			++m_Running;
+		}
+
+		task();
+
+		{
+			lock_guard<mutex> lock{m_Mutex};
+			--m_Running;
+		}
+
+		m_Idle.notify_all();
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running the submitted tasks in order.
+class ThreadPool {
+public:
+	explicit ThreadPool(std::size_t threads);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator = (const ThreadPool&) = delete;
+	ThreadPool(ThreadPool&&) = delete;
+	ThreadPool& operator = (ThreadPool&&) = delete;
+
+	// Tasks must not throw.
+	void submit(std::function<void()> task);
+
+	// Blocks until all the submitted tasks are done.
+	void wait();
+
+private:
+	void work();
+
+private:
+	std::deque<std::function<void()>> m_Tasks;
+	std::size_t m_Running = 0;
+	bool m_Stop = false;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_HasTask;
+	std::condition_variable m_Idle;
+
+	std::vector<std::thread> m_Threads;
+};
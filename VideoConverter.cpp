@@ -1,6 +1,11 @@
 #include "VideoConverter.h"
 #include "ProgramOptions.h"
 #include "opencvhelper.h"
+#include "yuvconverter.h"
+#include "Y4MWriter.h"
+#include "FrameSource.h"
+#include "ProgressReporter.h"
+#include "PooledFrameConverter.h"
 
 #include <opencv2/imgproc.hpp>
 #include <opencv2/videoio.hpp>  // Video write
@@ -9,28 +14,68 @@
 #include <FreeImage.h>
 
 #include <algorithm>
+#include <functional>
 #include <iterator>
 #include <vector>
 #include <string>
 #include <regex>
 #include <iostream>
+#include <chrono>
+#include <cstring>
 
 using namespace std;
 namespace fs = boost::filesystem;
 
+namespace {
+
+string rgbVideoFilename(const ProgramOptions& po)
+{
+	return po.videoName() + "." + po.videoExtension();
+}
+
+string alphaVideoFilename(const ProgramOptions& po)
+{
+	return po.videoName() + "_alpa." + po.videoExtension();
+}
+
+} // namespace
+
 struct VideoConverter::Impl {
-	explicit Impl(const ProgramOptions& po)
-		: m_ProgramOptions{po}
+	using FrameWrite = function<void(const vector<cv::Mat>& converted)>;
+
+	Impl(const ProgramOptions& po, ThreadPool* workers)
+		: m_ProgramOptions{po},
+		  m_Decoder{po.pngDecoder() == "freeimage" ? ImageDecoder::FreeImage : ImageDecoder::Auto},
+		  m_Workers{workers},
+		  m_FPS{po.fps()}
 	{
-		extractPaths();
+		if (m_ProgramOptions.input() == "-")
+		{
+			// a stream can only be read in order, by a single reader
+			m_Workers = nullptr;
+			openStdin();
+			return;
+		}
+
+		extractPaths(fs::path{m_ProgramOptions.input()});
 		filterPaths();
 		generateFrames();
 		getFrameInfo();
 		chackFrames();
+
+		if (!m_Workers)
+			m_FrameSource = readAheadIfBudget(make_unique<ImageSequenceSource>(m_Frames, m_Decoder));
 	}
 
 	void generateVideo()
     {
+		m_Progress = make_unique<ProgressReporter>(
+					progressFormat(),
+					rgbVideoFilename(),
+					m_Frames.size(),
+					static_cast<size_t>(m_FrameSize.area()) * m_Channels,
+					chrono::milliseconds{m_ProgramOptions.progressInterval()});
+
         switch (m_ProgramOptions.videoMode()) {
         case 1:
             generateRGBandAlphaVideo();
@@ -45,6 +90,8 @@ struct VideoConverter::Impl {
             generateVideoWithAlphaChannelAsGreen();
             break;
         }
+
+		m_Progress->finish();
 	}
 
 	const vector<fs::path>& foundImages() const noexcept
@@ -57,7 +104,184 @@ struct VideoConverter::Impl {
 		return m_Frames;
 	}
 
+	size_t comparePNGDecoders() const
+	{
+		using Clock = chrono::steady_clock;
+
+		Clock::duration freeImageTime{0};
+		Clock::duration autoTime{0};
+		size_t mismatches = 0;
+		cv::Mat freeImageFrame;
+		cv::Mat autoFrame;
+
+		for (size_t i = 0; i < m_Frames.size(); ++i)
+		{
+			const auto& filename = m_Frames[i].absolutePath;
+
+			// the decoder going first alternates, so that neither always
+			// finds the file in the page cache
+			if (i % 2 == 0)
+			{
+				freeImageTime += timeLoadImage(filename, freeImageFrame, ImageDecoder::FreeImage);
+				autoTime += timeLoadImage(filename, autoFrame, ImageDecoder::Auto);
+			}
+			else
+			{
+				autoTime += timeLoadImage(filename, autoFrame, ImageDecoder::Auto);
+				freeImageTime += timeLoadImage(filename, freeImageFrame, ImageDecoder::FreeImage);
+			}
+
+			if (!isIdentical(freeImageFrame, autoFrame))
+			{
+				cerr << filename << ": decoded frames differ" << endl;
+				++mismatches;
+			}
+		}
+
+		const auto frames = static_cast<double>(m_Frames.size());
+		const chrono::duration<double> freeImageSeconds = freeImageTime;
+		const chrono::duration<double> autoSeconds = autoTime;
+
+		cout << "frames:    " << m_Frames.size() << '\n'
+			 << "freeimage: " << freeImageSeconds.count() * 1000 << "ms, "
+			 << frames / freeImageSeconds.count() << " fps\n"
+			 << "auto:      " << autoSeconds.count() * 1000 << "ms, "
+			 << frames / autoSeconds.count() << " fps\n"
+			 << "speedup:   " << freeImageSeconds.count() / autoSeconds.count() << '\n'
+			 << "differing: " << mismatches << endl;
+
+		return mismatches;
+	}
+
 private:
+	static chrono::steady_clock::duration timeLoadImage(const string& filename, cv::Mat& frame,
+														ImageDecoder decoder)
+	{
+		const auto start = chrono::steady_clock::now();
+		loadImage(filename, frame, decoder);
+		return chrono::steady_clock::now() - start;
+	}
+
+	static bool isIdentical(const cv::Mat& lhs, const cv::Mat& rhs)
+	{
+		if (lhs.size() != rhs.size() || lhs.type() != rhs.type())
+			return false;
+
+		const auto rowBytes = lhs.cols * lhs.elemSize();
+
+		for (int r = 0; r < lhs.rows; ++r)
+			if (memcmp(lhs.ptr<uchar>(r), rhs.ptr<uchar>(r), rowBytes) != 0)
+				return false;
+
+		return true;
+	}
+
+	ProgressReporter::Format progressFormat() const noexcept
+	{
+		if (m_ProgramOptions.progress() == "human")
+			return ProgressReporter::Format::Human;
+
+		if (m_ProgramOptions.progress() == "machine")
+			return ProgressReporter::Format::Machine;
+
+		return ProgressReporter::Format::None;
+	}
+
+	void openStdin()
+	{
+		auto source = make_unique<StreamFrameSource>(
+					stdin,
+					m_ProgramOptions.inputFormat(),
+					m_ProgramOptions.pixelFormat(),
+					m_ProgramOptions.frameSize());
+
+		m_FrameSize = source->frameSize();
+		m_Channels = 4;
+
+		// the rate of the stream header wins over --fps
+		if (source->fps() > 0)
+			m_FPS = source->fps();
+
+		m_FrameSource = readAheadIfBudget(move(source));
+	}
+
+	// Bounds by the memory budget all the frame buffers of the read ahead,
+	// including the one being read and the one being encoded.
+	unique_ptr<FrameSource> readAheadIfBudget(unique_ptr<FrameSource> source) const
+	{
+		const auto budget = m_ProgramOptions.memoryBudget();
+
+		if (budget == 0)
+			return source;
+
+		const size_t frameBytes = static_cast<size_t>(m_FrameSize.area()) * m_Channels;
+		const auto capacity = budget / frameBytes;
+
+		if (capacity < 2)
+		{
+			cerr << "memory budget of " << budget / (1024 * 1024) << "MiB cannot hold two frames of "
+				 << frameBytes / (1024.0 * 1024.0) << "MiB, reading frames without read ahead" << endl;
+			return source;
+		}
+
+		if (m_ProgramOptions.verbose() > 3)
+			cout << "reading with up to " << capacity << " frames in memory" << endl;
+
+		return make_unique<PrefetchingFrameSource>(move(source), capacity);
+	}
+
+	// Bounds by the memory budget the frames decoded and converted ahead on
+	// the workers, counting the converted buffers being written. A slot holds
+	// a decoded frame and at most 1.5 times its size of converted buffers.
+	size_t pooledSlots() const
+	{
+		const auto budget = m_ProgramOptions.memoryBudget();
+		const size_t frameBytes = static_cast<size_t>(m_FrameSize.area()) * m_Channels;
+		const auto convertedBytes = frameBytes + frameBytes / 2;
+		const auto slotBytes = frameBytes + convertedBytes;
+
+		if (budget < slotBytes + convertedBytes)
+		{
+			if (budget != 0)
+				cerr << "memory budget of " << budget / (1024 * 1024) << "MiB cannot hold a frame of "
+					 << frameBytes / (1024.0 * 1024.0) << "MiB and its conversions, converting one frame ahead" << endl;
+			return 1;
+		}
+
+		const auto slots = (budget - convertedBytes) / slotBytes;
+
+		if (m_ProgramOptions.verbose() > 3)
+			cout << "converting up to " << slots << " frames ahead" << endl;
+
+		return slots;
+	}
+
+	// Skips frames that cannot be read. Logic errors are broken invariants of
+	// the frame source, not bad frames, so they stop the conversion.
+	bool readFrame(cv::Mat& frame)
+	{
+		for (;;)
+		{
+			try
+			{
+				return m_FrameSource->read(frame);
+			}
+			catch (const runtime_error& exc)
+			{
+				skipFrame(m_FrameSource->name(), exc);
+			}
+			catch (const cv::Exception& exc)
+			{
+				skipFrame(m_FrameSource->name(), exc);
+			}
+		}
+	}
+
+	static void skipFrame(const string& name, const exception& exc)
+	{
+		cerr << "skipping " << name << ":" << exc.what() << endl;
+	}
+
 	void extractPaths(fs::path p = fs::path{"."})
 	{
         copy_if(fs::directory_iterator(p), fs::directory_iterator(),
@@ -77,7 +301,7 @@ private:
         if (m_ProgramOptions.verbose() > 4)
             cout << "opening " << filename << endl;
 
-        auto frame = loadImage(filename);
+        auto frame = loadImage(filename, m_Decoder);
 
         m_FrameSize = cv::Size{frame.cols, frame.rows};
         m_Channels = frame.channels();
@@ -140,7 +364,7 @@ private:
 		for_each(begin(m_Frames), end(m_Frames),
 				[this](const auto& frame)
         {
-            cv::Mat f = loadImage(frame.absolutePath);
+            cv::Mat f = loadImage(frame.absolutePath, m_Decoder);
 			cv::Size currSize{ f.cols, f.rows };
 
 			if ( currSize != m_FrameSize || f.channels() != m_Channels )
@@ -153,120 +377,219 @@ private:
 		});
 	}
 
+	string rgbVideoFilename() const
+	{
+		return ::rgbVideoFilename(m_ProgramOptions);
+	}
+
+	string alphaVideoFilename() const
+	{
+		return ::alphaVideoFilename(m_ProgramOptions);
+	}
+
+	bool isY4MOutput() const noexcept
+	{
+		return m_ProgramOptions.videoExtension() == "y4m";
+	}
+
+	void checkY4MFrameSize() const
+	{
+		if (m_FrameSize.width % 2 != 0 || m_FrameSize.height % 2 != 0)
+			throw runtime_error{"y4m output requires even frame width and height"};
+	}
+
     void generateRGBandAlphaVideo()
     {
-		using namespace string_literals;
-
-		auto rgbVideoFilename = m_ProgramOptions.videoName() + "."s
-                + m_ProgramOptions.videoExtension();
-		auto alphaVideoFilename = m_ProgramOptions.videoName() + "_alpa"s
-				+ "."s + m_ProgramOptions.videoExtension();
+		if (isY4MOutput())
+		{
+			generateRGBandAlphaY4M();
+			return;
+		}
 
         cv::VideoWriter videoWriterRGB{
-                    rgbVideoFilename,
+                    rgbVideoFilename(),
                     m_ProgramOptions.fourcc(),
-                    m_ProgramOptions.fps(),
+                    m_FPS,
                     m_FrameSize
         };
 
         cv::VideoWriter videoWriterAlpha{
-                    alphaVideoFilename,
+                    alphaVideoFilename(),
                     m_ProgramOptions.fourcc(),
-                    m_ProgramOptions.fps(),
+                    m_FPS,
                     m_FrameSize
         };
 
-        for( const auto f : m_Frames)
+        encode([](const cv::Mat& frame, vector<cv::Mat>& converted)
         {
-            try
-            {
-                const auto frame = loadImage(f.absolutePath);
-                cv::Mat rgbFrame;
-                cv::cvtColor(frame, rgbFrame, cv::COLOR_BGRA2BGR);
-
-                vector<cv::Mat> spl;
-                cv::split(frame, spl);
-
-				cv::Mat alphaFrame;
-				cv::cvtColor(spl[3], alphaFrame, cv::COLOR_GRAY2BGR);
-
-                videoWriterRGB << rgbFrame;
-				videoWriterAlpha << alphaFrame;
-
-				displayParsedFileIf(m_ProgramOptions.verbose() > 4, f.absolutePath);
-				displayWindowsIf(m_ProgramOptions.verbose() > 5, rgbFrame, alphaFrame);
-            }
-            catch (const exception& exc)
-            {
-                cerr << "skipping " << f.absolutePath << ":" << exc.what() << endl;
-                continue;
-            }
-        }
+            converted.resize(2);
+            splitBGRAIntoBGRAndAlpha(frame, converted[0], converted[1]);
+        },
+        [&](const vector<cv::Mat>& converted)
+        {
+            videoWriterRGB << converted[0];
+            videoWriterAlpha << converted[1];
+
+            displayWindowsIf(m_ProgramOptions.verbose() > 5, converted[0], converted[1]);
+        });
     }
 
+	// The conversion to yuv happens here, so the encoder reading the y4m
+	// stream does not have to do it on its own thread.
+	void generateRGBandAlphaY4M()
+	{
+		checkY4MFrameSize();
+
+		Y4MWriter videoWriterRGB{rgbVideoFilename(), m_FrameSize, m_FPS};
+		Y4MWriter videoWriterAlpha{alphaVideoFilename(), m_FrameSize, m_FPS};
+
+		// in full range an opaque gray frame has neutral chroma, so the alpha
+		// plane is directly the luma of the alpha video
+		const cv::Mat neutralChroma(chromaSize(m_FrameSize), CV_8UC1, cv::Scalar{128});
+
+		encode([](const cv::Mat& frame, vector<cv::Mat>& converted)
+		{
+			converted.resize(4);
+			convertBGRAToYUVA420P(frame, converted[0], converted[1], converted[2], converted[3]);
+		},
+		[&](const vector<cv::Mat>& converted)
+		{
+			videoWriterRGB.write(converted[0], converted[1], converted[2]);
+			videoWriterAlpha.write(converted[3], neutralChroma, neutralChroma);
+
+			displayWindowIf(m_ProgramOptions.verbose() > 5, converted[0]);
+		});
+	}
+
     void generateVideoWithAlphaChannelMergetAtBottom()
     {
-		auto rgbVideoFilename = m_ProgramOptions.videoName() + "."s
-                + m_ProgramOptions.videoExtension();
+		if (isY4MOutput())
+		{
+			generateVideoWithAlphaChannelMergetAtBottomY4M();
+			return;
+		}
 
-        auto newFrameSize = cv::Size{m_FrameSize.width, m_FrameSize.height * 2};
+        const auto frameSize = m_FrameSize;
+        const auto newFrameSize = cv::Size{frameSize.width, frameSize.height * 2};
 
         cv::VideoWriter videoWriterRGBWithAlphaAtBottom{
-                    rgbVideoFilename,
+                    rgbVideoFilename(),
                     m_ProgramOptions.fourcc(),
-                    m_ProgramOptions.fps(),
+                    m_FPS,
                     newFrameSize
         };
 
-        for( const auto f : m_Frames)
+        encode([frameSize, newFrameSize](const cv::Mat& frame, vector<cv::Mat>& converted)
         {
-            try
-            {
-                const auto frame = loadImage(f.absolutePath);
-                cv::Mat rgbFrame;
-                cv::cvtColor(frame, rgbFrame, cv::COLOR_BGRA2BGR);
+            converted.resize(1);
+            converted[0].create(newFrameSize, CV_8UC3);
 
-                vector<cv::Mat> spl;
-                cv::split(frame, spl);
+            // both halves are written in place by the row bands
+            cv::Mat rgbFrame = converted[0].rowRange(0, frameSize.height);
+            cv::Mat alphaFrame = converted[0].rowRange(frameSize.height, newFrameSize.height);
 
-                cv::Mat alphaFrame;
-                cv::cvtColor(spl[3], alphaFrame, cv::COLOR_GRAY2BGR);
+            splitBGRAIntoBGRAndAlpha(frame, rgbFrame, alphaFrame);
+        },
+        [&](const vector<cv::Mat>& converted)
+        {
+            videoWriterRGBWithAlphaAtBottom << converted[0];
+            displayWindowIf(m_ProgramOptions.verbose() > 5, converted[0]);
+        });
+    }
 
-                const auto type = rgbFrame.type();
+	void generateVideoWithAlphaChannelMergetAtBottomY4M()
+	{
+		checkY4MFrameSize();
 
-                cv::Mat newFrame(newFrameSize.height, newFrameSize.width, type, cv::Scalar{0});
+		const auto frameSize = m_FrameSize;
+		const auto newFrameSize = cv::Size{frameSize.width, frameSize.height * 2};
+		const auto chroma = chromaSize(frameSize);
 
-                static const cv::Rect topRoi{0, 0, m_FrameSize.width, m_FrameSize.height};
-                static const cv::Rect bottomRoi{0, m_FrameSize.height,
-                            m_FrameSize.width, m_FrameSize.height};
+		Y4MWriter videoWriterRGBWithAlphaAtBottom{
+			rgbVideoFilename(), newFrameSize, m_FPS
+		};
 
-                rgbFrame.copyTo(newFrame(topRoi));
-				alphaFrame.copyTo(newFrame(bottomRoi));
+		encode([frameSize, newFrameSize, chroma](const cv::Mat& frame, vector<cv::Mat>& converted)
+		{
+			if (converted.empty())
+			{
+				converted.emplace_back(newFrameSize, CV_8UC1);
+				converted.emplace_back(chroma.height * 2, chroma.width, CV_8UC1, cv::Scalar{128});
+				converted.emplace_back(chroma.height * 2, chroma.width, CV_8UC1, cv::Scalar{128});
+			}
 
-				videoWriterRGBWithAlphaAtBottom << newFrame;
-				displayParsedFileIf(m_ProgramOptions.verbose() > 4, f.absolutePath);
-				displayWindowIf(m_ProgramOptions.verbose() > 5, newFrame);
+			// the colour frame is converted into the top half while the alpha
+			// channel lands straight in the bottom luma, whose chroma stays neutral
+			cv::Mat yTop = converted[0].rowRange(0, frameSize.height);
+			cv::Mat yBottom = converted[0].rowRange(frameSize.height, newFrameSize.height);
+			cv::Mat uTop = converted[1].rowRange(0, chroma.height);
+			cv::Mat vTop = converted[2].rowRange(0, chroma.height);
 
-            }
-            catch (const exception& exc)
-            {
-                cerr << "skipping " << f.absolutePath << ":" << exc.what() << endl;
-                continue;
-            }
-        }
-    }
+			convertBGRAToYUVA420P(frame, yTop, uTop, vTop, yBottom);
+		},
+		[&](const vector<cv::Mat>& converted)
+		{
+			videoWriterRGBWithAlphaAtBottom.write(converted[0], converted[1], converted[2]);
+			displayWindowIf(m_ProgramOptions.verbose() > 5, converted[0]);
+		});
+	}
+
+	// Converts and writes every frame in order, skipping the ones that fail.
+	void encode(const FrameConversion& convert, const FrameWrite& write)
+	{
+		if (m_Workers)
+		{
+			encodeOnWorkers(convert, write);
+			return;
+		}
+
+		cv::Mat frame;
+		vector<cv::Mat> converted;
+
+		while (readFrame(frame))
+		{
+			try
+			{
+				convert(frame, converted);
+				write(converted);
+				m_Progress->frameDone();
+			}
+			catch (const exception& exc)
+			{
+				skipFrame(m_FrameSource->name(), exc);
+			}
+		}
+	}
+
+	// The frames are decoded and converted by the shared workers, this
+	// thread only writes them.
+	void encodeOnWorkers(const FrameConversion& convert, const FrameWrite& write)
+	{
+		PooledFrameConverter converter{*m_Workers, m_Frames, m_Decoder, convert, pooledSlots()};
+		vector<cv::Mat> converted;
+
+		for (;;)
+		{
+			try
+			{
+				if (!converter.read(converted))
+					return;
+
+				write(converted);
+				m_Progress->frameDone();
+			}
+			catch (const exception& exc)
+			{
+				skipFrame(converter.name(), exc);
+			}
+		}
+	}
 
     void generateVideoWithAlphaChannelAsGreen()
     {
         throw std::runtime_error{"This mode is not still implemented"};
     }
 
-	void displayParsedFileIf(bool condition, const string& filename )
-	{
-		if (condition)
-			cout << "parsing " << filename << endl;
-	}
-
 	void displayWindowIf(bool condition, const cv::Mat& rgbFrame)
 	{
 		if (condition)
@@ -289,17 +612,28 @@ private:
 
 private:
 	const ProgramOptions& m_ProgramOptions;
+	const ImageDecoder m_Decoder;
+	ThreadPool* m_Workers;
 
 	vector<fs::path> m_Paths;
 	vector<fs::path> m_FilteredPaths;
 	vector<Frame> m_Frames;
 
+	unique_ptr<FrameSource> m_FrameSource;
+	unique_ptr<ProgressReporter> m_Progress;
+
 	cv::Size m_FrameSize;
 	int m_Channels;
+	double m_FPS;
 };
 
 VideoConverter::VideoConverter(const ProgramOptions& po)
-	: m_Impl{make_unique<VideoConverter::Impl>(po)}
+	: m_Impl{make_unique<VideoConverter::Impl>(po, nullptr)}
+{
+}
+
+VideoConverter::VideoConverter(const ProgramOptions& po, ThreadPool& workers)
+	: m_Impl{make_unique<VideoConverter::Impl>(po, &workers)}
 {
 }
 
@@ -322,6 +656,19 @@ const vector<Frame>& VideoConverter::frames() const noexcept
 	return m_Impl->frames();
 }
 
+size_t VideoConverter::comparePNGDecoders() const
+{
+	return m_Impl->comparePNGDecoders();
+}
+
+vector<string> VideoConverter::outputFilenames(const ProgramOptions& po)
+{
+	if (po.videoMode() == 1)
+		return {rgbVideoFilename(po), alphaVideoFilename(po)};
+
+	return {rgbVideoFilename(po)};
+}
+
 ostream& operator << (ostream& os, const Frame& f)
 {
 	os << f.index << ": " << f.name << " " << f.ext << " \"" << f.absolutePath << '"';
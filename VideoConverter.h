@@ -2,10 +2,12 @@
 
 #include <boost/filesystem/path.hpp>
 #include <memory>
+#include <string>
 #include <vector>
 #include <iosfwd>
 
 class ProgramOptions;
+class ThreadPool;
 
 struct Frame
 {
@@ -25,6 +27,11 @@ struct Frame
 class VideoConverter {
 public:
 	explicit VideoConverter(const ProgramOptions& po);
+
+	// The frames of an image sequence are decoded and converted by tasks of
+	// workers, which can be shared with other conversions running at the
+	// same time, and only written by the thread calling generateVideo().
+	VideoConverter(const ProgramOptions& po, ThreadPool& workers);
 	~VideoConverter();
 
 	VideoConverter(const VideoConverter&) = delete;
@@ -34,6 +41,13 @@ public:
 
 	void generateVideo();
 
+	// Decodes every frame with FreeImage and with the automatic decoder,
+	// prints the timings and returns the number of frames that differ.
+	std::size_t comparePNGDecoders() const;
+
+	// Files written by generateVideo() for the program options.
+	static std::vector<std::string> outputFilenames(const ProgramOptions& po);
+
 	const std::vector<boost::filesystem::path>& foundImages() const noexcept;
 	const std::vector<Frame>& frames() const noexcept;
 
@@ -0,0 +1,79 @@
+#include "Y4MWriter.h"
+#include "yuvconverter.h"
+
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+long greatestCommonDivisor(long a, long b) noexcept
+{
+	while (b != 0)
+	{
+		const auto t = a % b;
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+
+} // namespace
+
+Y4MWriter::Y4MWriter(const string& filename, const cv::Size& frameSize, double fps)
+	: m_FrameSize{frameSize},
+	  m_Buffer(1 << 22)
+{
+	if (fps <= 0)
+		throw invalid_argument{"fps must be greater than 0"};
+
+	m_Stream.rdbuf()->pubsetbuf(m_Buffer.data(), m_Buffer.size());
+	m_Stream.open(filename, ios::binary | ios::trunc);
+
+	if (!m_Stream)
+		throw runtime_error{"cannot open " + filename};
+
+	long num = lround(fps * 1000);
+	long den = 1000;
+	const auto gcd = greatestCommonDivisor(num, den);
+
+	m_Stream << "YUV4MPEG2"
+			 << " W" << m_FrameSize.width
+			 << " H" << m_FrameSize.height
+			 << " F" << num / gcd << ':' << den / gcd
+			 << " Ip A1:1 C420jpeg XCOLORRANGE=FULL\n";
+}
+
+Y4MWriter::~Y4MWriter()
+{
+}
+
+void Y4MWriter::write(const cv::Mat& y, const cv::Mat& u, const cv::Mat& v)
+{
+	const auto chroma = chromaSize(m_FrameSize);
+
+	m_Stream << "FRAME\n";
+	writePlane(y, m_FrameSize);
+	writePlane(u, chroma);
+	writePlane(v, chroma);
+
+	if (!m_Stream)
+		throw runtime_error{"error writing y4m frame"};
+}
+
+void Y4MWriter::writePlane(const cv::Mat& plane, const cv::Size& expectedSize)
+{
+	if (plane.size() != expectedSize || plane.type() != CV_8UC1)
+		throw invalid_argument{"y4m plane has invalid size or type"};
+
+	if (plane.isContinuous())
+	{
+		m_Stream.write(plane.ptr<char>(), plane.total());
+		return;
+	}
+
+	for (int r = 0; r < plane.rows; ++r)
+		m_Stream.write(plane.ptr<char>(r), plane.cols);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Writes planar 4:2:0 frames as a full range YUV4MPEG2 stream, which can be
+// handed to an external encoder without any further colorspace conversion.
+class Y4MWriter {
+public:
+	Y4MWriter(const std::string& filename, const cv::Size& frameSize, double fps);
+	~Y4MWriter();
+
+	Y4MWriter(const Y4MWriter&) = delete;
+	Y4MWriter& operator = (const Y4MWriter&) = delete;
+	Y4MWriter(Y4MWriter&&) = delete;
+	Y4MWriter& operator = (Y4MWriter&&) = delete;
+
+	void write(const cv::Mat& y, const cv::Mat& u, const cv::Mat& v);
+
+private:
+	void writePlane(const cv::Mat& plane, const cv::Size& expectedSize);
+
+private:
+	cv::Size m_FrameSize;
+	std::vector<char> m_Buffer;
+	std::ofstream m_Stream;
+};
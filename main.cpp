@@ -1,5 +1,6 @@
 #include "ProgramOptions.h"
 #include "VideoConverter.h"
+#include "BatchConverter.h"
 #include <iostream>
 
 using namespace std;
@@ -15,9 +16,18 @@ int main(int argc, char *argv[])
 		else if( po.shouldDisplayOnlyVersion())
 			return EXIT_SUCCESS;
 
+		if (!po.jobsFile().empty())
+		{
+			BatchConverter bc{po, argc, argv};
+			return bc.run() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
 		VideoConverter vc{po};
 
-		if (vc.frames().empty())
+		if (po.shouldComparePNGDecoders())
+			return vc.comparePNGDecoders() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+
+		if (po.input() != "-" && vc.frames().empty())
 			cout << "no files filtered" << endl;
 
 		vc.generateVideo();
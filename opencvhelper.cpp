@@ -1,6 +1,17 @@
 #include "opencvhelper.h"
+#include "parallelhelper.h"
 #include <opencv2/imgproc.hpp>
 #include <FreeImage.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <memory>
+#include <new>
+#include <stdexcept>
+
+#ifdef HAVE_LIBPNG
+#include <png.h>
+#endif
 
 using namespace cv;
 using namespace std;
@@ -85,15 +96,159 @@ void FI2MAT(FIBITMAP* src, Mat& dst)
         }
     }
 
-    flip(dst, dst, 0);
+    // flipping out of place gives a frame that does not reference the bitmap
+    Mat flipped;
+    flip(dst, flipped, 0);
+    dst = flipped;
 }
 
-Mat loadImage(const string& filename)
+namespace {
+
+#ifdef HAVE_LIBPNG
+bool hasPNGExtension(const string& filename)
 {
-    auto type = FreeImage_GetFileType(filename.c_str());
-    auto bitmap = FreeImage_Load(type, filename.c_str());
+    if (filename.size() < 4)
+        return false;
+
+    auto ext = filename.substr(filename.size() - 4);
+    transform(begin(ext), end(ext), begin(ext), [](unsigned char c) { return tolower(c); });
+    return ext == ".png";
+}
+
+// Decodes 8 bit RGBA PNGs straight into a top-down BGRA frame, returns false
+// for the other formats that are left to FreeImage. Like FreeImage loading
+// with PNG_IGNOREGAMMA no colour transform is applied, so both decoders return
+// the samples stored in the file.
+bool loadPNG(const string& filename, Mat& dst)
+{
+    unique_ptr<FILE, int (*)(FILE*)> file{fopen(filename.c_str(), "rb"), fclose};
+
+    if (!file)
+        return false;
+
+    png_byte signature[8];
+
+    if (fread(signature, 1, sizeof signature, file.get()) != sizeof signature
+            || png_sig_cmp(signature, 0, sizeof signature) != 0)
+        return false;
+
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    png_infop info = png ? png_create_info_struct(png) : nullptr;
+
+    if (!info)
+    {
+        png_destroy_read_struct(&png, nullptr, nullptr);
+        throw bad_alloc{};
+    }
+
+    if (setjmp(png_jmpbuf(png)))
+    {
+        png_destroy_read_struct(&png, &info, nullptr);
+        throw runtime_error{"cannot decode " + filename};
+    }
+
+    png_init_io(png, file.get());
+    png_set_sig_bytes(png, sizeof signature);
+    png_read_info(png, info);
+
+    if (png_get_color_type(png, info) != PNG_COLOR_TYPE_RGB_ALPHA || png_get_bit_depth(png, info) != 8)
+    {
+        png_destroy_read_struct(&png, &info, nullptr);
+        return false;
+    }
+
+    png_set_bgr(png);
+    const int passes = png_set_interlace_handling(png);
+    png_read_update_info(png, info);
+
+    const auto width = static_cast<int>(png_get_image_width(png, info));
+    const auto height = static_cast<int>(png_get_image_height(png, info));
+
+    dst.create(height, width, CV_8UC4);
+
+    // rows are read one by one: no local object changes after setjmp
+    for (int pass = 0; pass < passes; ++pass)
+        for (int r = 0; r < height; ++r)
+            png_read_row(png, dst.ptr<png_byte>(r), nullptr);
+    png_read_end(png, nullptr);
+    png_destroy_read_struct(&png, &info, nullptr);
+
+    return true;
+}
+#endif
+
+} // namespace
 
-    cv::Mat mat;
-    FI2MAT(bitmap, mat);
+Mat loadImage(const string& filename, ImageDecoder decoder)
+{
+    Mat mat;
+    loadImage(filename, mat, decoder);
     return mat;
 }
+
+void loadImage(const string& filename, Mat& dst, ImageDecoder decoder)
+{
+#ifdef HAVE_LIBPNG
+    if (decoder == ImageDecoder::Auto && hasPNGExtension(filename) && loadPNG(filename, dst))
+        return;
+#else
+    (void)decoder;
+#endif
+
+    auto type = FreeImage_GetFileType(filename.c_str());
+
+    // the PNG plugin applies the gAMA chunk unless told otherwise, the samples
+    // stored in the file are returned instead, as by the libpng path
+    auto bitmap = FreeImage_Load(type, filename.c_str(), type == FIF_PNG ? PNG_IGNOREGAMMA : 0);
+
+    if (!bitmap)
+        throw runtime_error{"cannot load " + filename};
+
+    FI2MAT(bitmap, dst);
+    FreeImage_Unload(bitmap);
+}
+
+namespace {
+
+void prepareBGR(Mat& dst, const Size& size)
+{
+    if (dst.empty())
+        dst.create(size, CV_8UC3);
+
+    if (dst.size() != size || dst.type() != CV_8UC3)
+        throw invalid_argument{"destination frame has invalid size or type"};
+}
+
+void splitRow(const uchar* src, uchar* bgr, uchar* alpha, int width) noexcept
+{
+    for (int x = 0; x < width; ++x)
+    {
+        const uchar* p = src + 4 * x;
+        bgr[3 * x] = p[0];
+        bgr[3 * x + 1] = p[1];
+        bgr[3 * x + 2] = p[2];
+        alpha[3 * x] = p[3];
+        alpha[3 * x + 1] = p[3];
+        alpha[3 * x + 2] = p[3];
+    }
+}
+
+} // namespace
+
+void splitBGRAIntoBGRAndAlpha(const Mat& bgra, Mat& bgr, Mat& alphaBGR)
+{
+    if (bgra.type() != CV_8UC4)
+        throw invalid_argument{"frame must be 8 bit BGRA"};
+
+    prepareBGR(bgr, bgra.size());
+    prepareBGR(alphaBGR, bgra.size());
+
+    // every row reads 4 bytes and writes 2 * 3 bytes per pixel
+    const size_t bytesPerRow = static_cast<size_t>(bgra.cols) * 10;
+
+    parallelForRowBands(bgra.rows, bytesPerRow, [&](int begin, int end)
+    {
+        for (int r = begin; r < end; ++r)
+            splitRow(bgra.ptr<uchar>(r), bgr.ptr<uchar>(r), alphaBGR.ptr<uchar>(r), bgra.cols);
+    });
+}
@@ -3,4 +3,19 @@
 #include <opencv2/core.hpp>
 #include <string>
 
-cv::Mat loadImage(const std::string& filename);
+enum class ImageDecoder {
+	Auto,       // 8 bit RGBA PNGs through libpng when available, FreeImage otherwise
+	FreeImage
+};
+
+cv::Mat loadImage(const std::string& filename, ImageDecoder decoder = ImageDecoder::Auto);
+
+// Same as above but the decoded frame reuses the memory of dst when possible.
+void loadImage(const std::string& filename, cv::Mat& dst,
+			   ImageDecoder decoder = ImageDecoder::Auto);
+
+// Splits an 8 bit BGRA frame into its BGR colour and its alpha replicated on
+// the three BGR channels. The work is split in row bands processed in
+// parallel. Destinations may be views into a larger frame and are allocated
+// only when empty.
+void splitBGRAIntoBGRAndAlpha(const cv::Mat& bgra, cv::Mat& bgr, cv::Mat& alphaBGR);
@@ -0,0 +1,76 @@
+#include "parallelhelper.h"
+
+#include <opencv2/core.hpp>
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+class RowBandsBody : public cv::ParallelLoopBody {
+public:
+	RowBandsBody(int rows, int rowsPerBand, const function<void(int, int)>& body)
+		: m_Rows{rows}, m_RowsPerBand{rowsPerBand}, m_Body(body)
+	{
+	}
+
+	void operator()(const cv::Range& range) const override
+	{
+		for (int band = range.start; band < range.end; ++band)
+		{
+			const int begin = band * m_RowsPerBand;
+			const int end = min(begin + m_RowsPerBand, m_Rows);
+			m_Body(begin, end);
+		}
+	}
+
+private:
+	const int m_Rows;
+	const int m_RowsPerBand;
+	const function<void(int, int)>& m_Body;
+};
+
+size_t queryL2CacheSize() noexcept
+{
+#if defined(__linux__) && defined(_SC_LEVEL2_CACHE_SIZE)
+	const auto size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+	if (size > 0)
+		return static_cast<size_t>(size);
+#endif
+
+	return 256 * 1024;
+}
+
+} // namespace
+
+size_t l2CacheSize() noexcept
+{
+	static const auto size = queryL2CacheSize();
+	return size;
+}
+
+void parallelForRowBands(int rows, size_t bytesPerRow, const function<void(int, int)>& body)
+{
+	if (rows <= 0)
+		return;
+
+	// half of the cache is left to the other data the core is touching
+	const auto budget = l2CacheSize() / 2;
+	const auto rowsPerBand = static_cast<int>(
+				min<size_t>(rows, max<size_t>(1, budget / max<size_t>(1, bytesPerRow))));
+	const int bands = (rows + rowsPerBand - 1) / rowsPerBand;
+
+	if (bands == 1)
+	{
+		body(0, rows);
+		return;
+	}
+
+	const RowBandsBody rowBandsBody{rows, rowsPerBand, body};
+	cv::parallel_for_(cv::Range{0, bands}, rowBandsBody, bands);
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+// Size in bytes of the per core L2 cache, 256 KiB when it cannot be queried.
+std::size_t l2CacheSize() noexcept;
+
+// Splits [0, rows) into bands small enough for their working set, given by
+// bytesPerRow, to stay in L2 and runs body(begin, end) for every band on the
+// OpenCV thread pool.
+void parallelForRowBands(int rows, std::size_t bytesPerRow,
+						 const std::function<void(int, int)>& body);
@@ -0,0 +1,144 @@
+#include "yuvconverter.h"
+#include "parallelhelper.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace cv;
+using namespace std;
+
+namespace {
+
+// 16 bit fixed point full range BT.601 coefficients
+constexpr int YR = 19595, YG = 38470, YB = 7471;
+constexpr int UR = -11059, UG = -21709, UB = 32768;
+constexpr int VR = 32768, VG = -27439, VB = -5329;
+
+// The row kernels are plain branch free loops over contiguous memory so that
+// the compiler can vectorize them: CMakeLists.txt builds this file with -O3,
+// below which GCC and Clang leave them scalar.
+inline void lumaRow(const uchar* src, uchar* y, int width) noexcept
+{
+	for (int x = 0; x < width; ++x)
+	{
+		const int b = src[4 * x];
+		const int g = src[4 * x + 1];
+		const int r = src[4 * x + 2];
+		y[x] = static_cast<uchar>((YR * r + YG * g + YB * b + (1 << 15)) >> 16);
+	}
+}
+
+inline void alphaRow(const uchar* src, uchar* a, int width) noexcept
+{
+	for (int x = 0; x < width; ++x)
+		a[x] = src[4 * x + 3];
+}
+
+// sr, sg and sb are the sums of a 2x2 block, so the scale is 2^18
+inline uchar chroma(int sr, int sg, int sb, int cr, int cg, int cb) noexcept
+{
+	const int value = (cr * sr + cg * sg + cb * sb + (128 << 18) + (1 << 17)) >> 18;
+	return static_cast<uchar>(min(value, 255));
+}
+
+inline void chromaRow(const uchar* src0, const uchar* src1, uchar* u, uchar* v, int width) noexcept
+{
+	const int pairs = width / 2;
+
+	for (int cx = 0; cx < pairs; ++cx)
+	{
+		const uchar* p0 = src0 + 8 * cx;
+		const uchar* p1 = src1 + 8 * cx;
+		const int sb = p0[0] + p0[4] + p1[0] + p1[4];
+		const int sg = p0[1] + p0[5] + p1[1] + p1[5];
+		const int sr = p0[2] + p0[6] + p1[2] + p1[6];
+		u[cx] = chroma(sr, sg, sb, UR, UG, UB);
+		v[cx] = chroma(sr, sg, sb, VR, VG, VB);
+	}
+
+	if (width & 1)
+	{
+		const uchar* p0 = src0 + 4 * (width - 1);
+		const uchar* p1 = src1 + 4 * (width - 1);
+		const int sb = 2 * (p0[0] + p1[0]);
+		const int sg = 2 * (p0[1] + p1[1]);
+		const int sr = 2 * (p0[2] + p1[2]);
+		u[pairs] = chroma(sr, sg, sb, UR, UG, UB);
+		v[pairs] = chroma(sr, sg, sb, VR, VG, VB);
+	}
+}
+
+// Converts the pair of luma rows covered by the chroma row cy.
+void convertChromaRow(const Mat& src, Mat& y, Mat& u, Mat& v, Mat* a, int cy) noexcept
+{
+	const int width = src.cols;
+	const int r0 = 2 * cy;
+	const int r1 = min(r0 + 1, src.rows - 1);
+	const uchar* src0 = src.ptr<uchar>(r0);
+	const uchar* src1 = src.ptr<uchar>(r1);
+
+	lumaRow(src0, y.ptr<uchar>(r0), width);
+	if (r1 != r0)
+		lumaRow(src1, y.ptr<uchar>(r1), width);
+
+	chromaRow(src0, src1, u.ptr<uchar>(cy), v.ptr<uchar>(cy), width);
+
+	if (a)
+	{
+		alphaRow(src0, a->ptr<uchar>(r0), width);
+		if (r1 != r0)
+			alphaRow(src1, a->ptr<uchar>(r1), width);
+	}
+}
+
+void preparePlane(Mat& plane, const Size& size)
+{
+	if (plane.empty())
+		plane.create(size, CV_8UC1);
+
+	if (plane.size() != size || plane.type() != CV_8UC1)
+		throw invalid_argument{"destination plane has invalid size or type"};
+}
+
+void convert(const Mat& bgra, Mat& y, Mat& u, Mat& v, Mat* a)
+{
+	if (bgra.type() != CV_8UC4)
+		throw invalid_argument{"yuv conversion requires an 8 bit BGRA frame"};
+
+	const auto lumaSize = bgra.size();
+	const auto chromaPlaneSize = chromaSize(lumaSize);
+
+	preparePlane(y, lumaSize);
+	preparePlane(u, chromaPlaneSize);
+	preparePlane(v, chromaPlaneSize);
+
+	if (a)
+		preparePlane(*a, lumaSize);
+
+	// a chroma row reads two BGRA rows and writes two luma rows, one row for
+	// each chroma plane and possibly two alpha rows
+	const size_t bytesPerRow = static_cast<size_t>(bgra.cols) * (a ? 12 : 10) + bgra.cols;
+
+	parallelForRowBands(chromaPlaneSize.height, bytesPerRow, [&](int begin, int end)
+	{
+		for (int cy = begin; cy < end; ++cy)
+			convertChromaRow(bgra, y, u, v, a, cy);
+	});
+}
+
+} // namespace
+
+Size chromaSize(const Size& lumaSize) noexcept
+{
+	return Size{(lumaSize.width + 1) / 2, (lumaSize.height + 1) / 2};
+}
+
+void convertBGRAToYUV420P(const Mat& bgra, Mat& y, Mat& u, Mat& v)
+{
+	convert(bgra, y, u, v, nullptr);
+}
+
+void convertBGRAToYUVA420P(const Mat& bgra, Mat& y, Mat& u, Mat& v, Mat& a)
+{
+	convert(bgra, y, u, v, &a);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+// Full range BT.601 conversion of an 8 bit BGRA frame into planar 4:2:0.
+// Destination planes are CV_8UC1 and may be views (ROIs) into a larger
+// buffer: they are allocated only when empty.
+cv::Size chromaSize(const cv::Size& lumaSize) noexcept;
+
+void convertBGRAToYUV420P(const cv::Mat& bgra, cv::Mat& y, cv::Mat& u, cv::Mat& v);
+
+// Same as convertBGRAToYUV420P and additionally extracts the alpha channel
+// in the full resolution plane a.
+void convertBGRAToYUVA420P(const cv::Mat& bgra, cv::Mat& y, cv::Mat& u, cv::Mat& v,
+						   cv::Mat& a);